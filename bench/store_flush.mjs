@@ -0,0 +1,78 @@
+// MBASIC 5.21 WebAssembly - File Store Flush Benchmark
+// Measures what a FileStore sync costs against the in-memory backend:
+// a program appends records to a growing file and the store is flushed
+// after every append, as CLOSE/PRINT# flushes would.
+//
+// Run with: node bench/store_flush.mjs [records] [record-length]
+
+import { BLOCK_SIZE, FileStore, MemoryBackend } from '../web/mbasic-store.js';
+
+const RECORDS = Number(process.argv[2]) || 2000;
+const RECORD_LENGTH = Number(process.argv[3]) || 64;
+
+function record(i) {
+    return `${i},`.padEnd(RECORD_LENGTH - 1, 'x') + '\n';
+}
+
+// Append one record per flush, with or without block-level diffing
+async function appendAndFlush(label, write) {
+    const backend = new MemoryBackend();
+    const store = new FileStore(backend);
+    let data = '';
+
+    const start = performance.now();
+    for (let i = 0; i < RECORDS; i++) {
+        data += record(i);
+        write(store, data);
+        await store.sync();
+    }
+    const elapsed = performance.now() - start;
+
+    console.log(`${label.padEnd(22)} ${elapsed.toFixed(1).padStart(9)} ms` +
+                `  ${(elapsed * 1000 / RECORDS).toFixed(1).padStart(8)} us/flush` +
+                `  ${backend.writes} writes` +
+                `  ${(backend.bytesWritten / 1024).toFixed(0)} KB written`);
+}
+
+// Rewrite one record in place in a full-size file, flushing each time
+async function rewriteAndFlush() {
+    const backend = new MemoryBackend();
+    const store = new FileStore(backend);
+    const records = [];
+    for (let i = 0; i < RECORDS; i++) {
+        records.push(record(i));
+    }
+    store.set('DATA.DAT', records.join(''));
+    await store.sync();
+    const baseline = backend.bytesWritten;
+
+    const start = performance.now();
+    for (let i = 0; i < RECORDS; i++) {
+        records[i] = record(RECORDS - i);
+        store.set('DATA.DAT', records.join(''));
+        await store.sync();
+    }
+    const elapsed = performance.now() - start;
+
+    console.log(`${'random rewrite'.padEnd(22)} ${elapsed.toFixed(1).padStart(9)} ms` +
+                `  ${(elapsed * 1000 / RECORDS).toFixed(1).padStart(8)} us/flush` +
+                `  ${backend.writes - 1} writes` +
+                `  ${((backend.bytesWritten - baseline) / 1024).toFixed(0)} KB written`);
+}
+
+console.log(`${RECORDS} records of ${RECORD_LENGTH} bytes, ` +
+            `block size ${BLOCK_SIZE}, final file ` +
+            `${(RECORDS * RECORD_LENGTH / 1024).toFixed(0)} KB\n`);
+
+// Block diffing: set() marks only the blocks that changed
+await appendAndFlush('append (block diff)', (store, data) => {
+    store.set('DATA.DAT', data);
+});
+
+// Whole-file writes: delete first, so every block is written again
+await appendAndFlush('append (whole file)', (store, data) => {
+    store.files.delete('DATA.DAT');
+    store.set('DATA.DAT', data);
+});
+
+await rewriteAndFlush();
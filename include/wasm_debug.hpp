@@ -0,0 +1,76 @@
+#pragma once
+// MBASIC WebAssembly - Debugger Instrumentation Policies
+// The session run loop is templated on one of these policies
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+namespace mbasic {
+
+// Normal runs: no per-statement hooks, the interpreter runs untouched
+struct NoDebugPolicy {
+    static constexpr bool enabled = false;
+
+    bool before_statement(int) { return false; }
+};
+
+// Debug runs: breakpoints, single stepping and a TRON trace ring buffer
+class DebugPolicy {
+public:
+    static constexpr bool enabled = true;
+    static constexpr int MAX_LINE = 65535;
+    static constexpr size_t TRACE_SIZE = 4096;
+    static constexpr int NO_LINE = -1;
+
+    // Called before each statement, returns true to pause at this line.
+    // Only entering a new line is traced and can pause, so a line with
+    // several statements is one step, and resuming on the paused line
+    // neither pauses again nor traces it twice.
+    bool before_statement(int line) {
+        if (line == current_line_) {
+            return false;
+        }
+        current_line_ = line;
+
+        trace_[trace_pos_] = line;
+        trace_pos_ = (trace_pos_ + 1) % TRACE_SIZE;
+        if (trace_count_ < TRACE_SIZE) {
+            trace_count_++;
+        }
+
+        if (step_) {
+            return true;
+        }
+        return line >= 0 && line <= MAX_LINE && breakpoints_.test(line);
+    }
+
+    // Forget per-run state (current line, stepping) before a new run
+    void start_run() {
+        current_line_ = NO_LINE;
+        step_ = false;
+    }
+
+    void set_breakpoint(int line, bool on);
+    void clear_breakpoints();
+    bool has_breakpoint(int line) const;
+
+    // Pause on every new line
+    void set_step(bool step) { step_ = step; }
+
+    // Copy the trace into execution order, oldest first
+    const std::vector<int32_t>& trace();
+    void clear_trace();
+
+private:
+    std::bitset<MAX_LINE + 1> breakpoints_;
+    std::array<int32_t, TRACE_SIZE> trace_{};
+    std::vector<int32_t> ordered_;
+    size_t trace_pos_ = 0;
+    size_t trace_count_ = 0;
+    int current_line_ = NO_LINE;
+    bool step_ = false;
+};
+
+} // namespace mbasic
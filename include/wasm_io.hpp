@@ -3,6 +3,7 @@
 // Implements IOHandler interface for web browser environment
 
 #include <mbasic/io_handler.hpp>
+#include "wasm_replay.hpp"
 #include <string>
 #include <optional>
 
@@ -10,11 +11,12 @@ namespace mbasic {
 
 // JavaScript callback functions (implemented in JavaScript, called from C++)
 extern "C" {
-    // Print text to the terminal
-    void js_print(const char* text);
+    // Print length bytes of UTF-8 text to the terminal (may contain NULs)
+    void js_print(const char* text, int length);
 
     // Get input from user (blocking via ASYNCIFY)
-    // Prompt is displayed, returns dynamically allocated string
+    // Prompt is displayed, returns dynamically allocated string,
+    // or nullptr if the user pressed Break instead of answering
     char* js_input(const char* prompt);
 
     // Non-blocking key check (returns -1 if no key, else character code)
@@ -24,6 +26,12 @@ extern "C" {
     void js_clear_screen();
 }
 
+// Thrown out of WasmIO::input when Break is pressed while INPUT waits.
+// The INPUT statement is abandoned before it assigns anything, so CONT
+// executes it again, as MBASIC does. Deliberately not a std::exception,
+// so the interpreter's error handling does not turn it into a BASIC error.
+struct InputBreak {};
+
 // WebAssembly IOHandler implementation
 class WasmIO : public IOHandler {
 public:
@@ -39,7 +47,18 @@ public:
     void set_width(int w) override { width_ = w; }
     void clear_screen() override;
 
+    // Send buffered output to JavaScript
+    void flush();
+
+    // Record or replay INPUT and INKEY$ through this trace (nullptr = off)
+    void set_trace(InputTrace* trace) { trace_ = trace; }
+
 private:
+    // Output is collected here and handed to js_print in one call
+    static constexpr size_t OUTPUT_BUFFER_SIZE = 4096;
+
+    std::string output_;
+    InputTrace* trace_ = nullptr;
     int column_ = 0;
     int width_ = 80;
 };
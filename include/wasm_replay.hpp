@@ -0,0 +1,68 @@
+#pragma once
+// MBASIC WebAssembly - Input Record/Replay
+// Records terminal inputs (INPUT answers, Break at INPUT, INKEY$ polls)
+// into a compact binary trace and feeds them back for headless replay.
+// Nothing else is recorded: RND seeds, TIMER and file contents come from
+// the live session, so a trace is not a bit-for-bit reproduction of a run
+// and replay can diverge for programs that depend on them.
+
+#include <cstdint>
+#include <string>
+
+namespace mbasic {
+
+class InputTrace {
+public:
+    enum class Mode { OFF, RECORD, REPLAY };
+
+    // Begin recording a new trace
+    void start_recording();
+
+    // Begin replaying a trace, returns false if the data is not a trace
+    bool start_replay(const std::string& data);
+
+    // Stop recording or replaying (the trace data is kept)
+    void stop();
+
+    Mode mode() const { return mode_; }
+    bool recording() const { return mode_ == Mode::RECORD; }
+    bool replaying() const { return mode_ == Mode::REPLAY; }
+
+    // Encoded trace
+    const std::string& data();
+
+    // INPUT lines
+    void record_input(const std::string& line);
+    bool replay_input(std::string& line);
+
+    // Break pressed instead of answering INPUT
+    void record_input_break();
+    bool replay_input_break();
+
+    // INKEY$ polls (-1 = no key)
+    void record_inkey(int key);
+    bool replay_inkey(int& key);
+
+private:
+    enum Tag : uint8_t {
+        TAG_INPUT = 1,
+        TAG_KEY = 2,
+        TAG_NO_KEY = 3,      // Run of polls that returned no key
+        TAG_BREAK = 4,       // Break at INPUT
+    };
+
+    void flush_no_key();
+    void put_varint(uint32_t value);
+    void put_string(const std::string& s);
+    bool get_varint(uint32_t& value);
+    bool get_string(std::string& s);
+    bool expect(Tag tag);
+    void mismatch();
+
+    std::string data_;
+    size_t pos_ = 0;
+    uint32_t no_key_run_ = 0;
+    Mode mode_ = Mode::OFF;
+};
+
+} // namespace mbasic
@@ -2,35 +2,82 @@
 // Exposes the MBASIC interpreter to JavaScript
 
 #include <emscripten/bind.h>
+#include <emscripten/val.h>
 #include <emscripten.h>
+#include <malloc.h>
 #include <mbasic/lexer.hpp>
 #include <mbasic/parser.hpp>
 #include <mbasic/runtime.hpp>
 #include <mbasic/interpreter.hpp>
 #include <mbasic/error.hpp>
 #include "wasm_io.hpp"
+#include "wasm_debug.hpp"
+#include "wasm_replay.hpp"
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <sstream>
+#include <vector>
 
 using namespace emscripten;
 
 namespace {
 
+// Load/heap statistics for the session, exposed to JavaScript
+struct SessionStats {
+    int loads = 0;           // Number of successful loadProgram calls
+    int reuses = 0;          // Loads that reset the existing runtime in place
+    int releases = 0;        // Times the runtime objects were actually freed
+    double lastLoadMs = 0;   // Run-start latency of the most recent load
+    double maxLoadMs = 0;
+    double totalLoadMs = 0;
+    int heapInUse = 0;       // Bytes currently allocated by malloc
+    int heapHighWater = 0;   // Largest heapInUse seen so far
+    int heapSize = 0;        // Size of wasm linear memory
+};
+
+// Default heap threshold above which runtime objects are freed
+constexpr int DEFAULT_RECYCLE_LIMIT = 32 * 1024 * 1024;
+
 // Global state for the interpreter session
 class MBasicSession {
 public:
-    MBasicSession() : io_(std::make_unique<mbasic::WasmIO>()) {}
+    MBasicSession() : io_(std::make_unique<mbasic::WasmIO>()) {
+        io_->set_trace(&input_trace_);
+    }
 
     // Load a program from source code
+    // Program and Runtime are created once and then reset in place on
+    // every load, so variable tables and arrays keep their capacity between
+    // runs. They are only freed when the heap grows past the recycle limit.
+    // The Interpreter is recreated each time so none of its own state
+    // (stop/pause flags, pending input) carries over into the next run.
     bool loadProgram(const std::string& source) {
+        if (refuseWhileRunning()) {
+            return false;
+        }
+        double start = emscripten_get_now();
+        // Previous program, kept alive until the runtime has been reloaded
+        std::unique_ptr<mbasic::Program> replaced;
         try {
-            program_ = std::make_unique<mbasic::Program>(mbasic::parse(source));
+            if (runtime_ && heapInUse() > recycle_limit_) {
+                release();
+            }
+
+            auto parsed = std::make_unique<mbasic::Program>(mbasic::parse(source));
+            replaced = std::move(program_);
+            program_ = std::move(parsed);
             program_source_ = source;
-            runtime_ = std::make_unique<mbasic::Runtime>();
-            runtime_->load(*program_);
-            interpreter_ = std::make_unique<mbasic::Interpreter>(*runtime_, io_.get());
-            loaded_ = true;
+            attach(*program_);
+
+            double elapsed = emscripten_get_now() - start;
+            stats_.loads++;
+            stats_.lastLoadMs = elapsed;
+            stats_.totalLoadMs += elapsed;
+            if (elapsed > stats_.maxLoadMs) {
+                stats_.maxLoadMs = elapsed;
+            }
+            sampleHeap();
             return true;
         } catch (const mbasic::ParseError& e) {
             last_error_ = "Parse error at line " + std::to_string(e.line) +
@@ -48,40 +95,100 @@ public:
 
     // Run the loaded program
     void run() {
-        if (!loaded_ || !interpreter_) {
-            return;
+        can_continue_ = false;
+        debug_.start_run();
+        if (debugging_) {
+            execute(debug_);
+        } else {
+            mbasic::NoDebugPolicy policy;
+            execute(policy);
         }
+    }
 
-        try {
-            interpreter_->run();
-        } catch (const mbasic::RuntimeError& e) {
-            last_error_ = "Runtime error at line " + std::to_string(e.line) +
-                          ": " + e.what();
-            io_->print("\n" + last_error_ + "\n");
-        } catch (const std::exception& e) {
-            last_error_ = std::string("Error: ") + e.what();
-            io_->print("\n" + last_error_ + "\n");
-        }
+    // Continue after a breakpoint or step pause
+    void debugContinue() {
+        debug_.set_step(false);
+        execute(debug_);
+    }
+
+    // Execute to the start of the next line, then pause again
+    void debugStep() {
+        debug_.set_step(true);
+        execute(debug_);
     }
 
     // Execute a single tick (for cooperative multitasking)
     bool tick() {
-        if (!loaded_ || !interpreter_) {
+        if (executing_) {
             return false;
         }
+        ExecutingScope scope(executing_);
+        return step();
+    }
 
-        try {
-            return interpreter_->tick();
-        } catch (const mbasic::RuntimeError& e) {
-            last_error_ = "Runtime error at line " + std::to_string(e.line) +
-                          ": " + e.what();
-            io_->print("\n" + last_error_ + "\n");
-            return false;
-        } catch (const std::exception& e) {
-            last_error_ = std::string("Error: ") + e.what();
-            io_->print("\n" + last_error_ + "\n");
-            return false;
-        }
+    // Enable or disable debug runs (breakpoints, stepping, trace)
+    void setDebugging(bool enable) {
+        debugging_ = enable;
+    }
+
+    // Set or clear a breakpoint on a BASIC line number
+    void setBreakpoint(int line, bool on) {
+        debug_.set_breakpoint(line, on);
+    }
+
+    // Remove all breakpoints
+    void clearBreakpoints() {
+        debug_.clear_breakpoints();
+    }
+
+    // Line the debugger paused at, or -1 if not paused
+    int getPausedLine() const {
+        return paused_line_;
+    }
+
+    // Executed line numbers, oldest first, as an Int32Array view
+    // (valid until the next call into the module)
+    val getTrace() {
+        const std::vector<int32_t>& trace = debug_.trace();
+        return val(typed_memory_view(trace.size(), trace.data()));
+    }
+
+    // Discard the trace buffer
+    void clearTrace() {
+        debug_.clear_trace();
+    }
+
+    // Start recording INPUT, Break at INPUT and INKEY$ into a new trace
+    void startRecording() {
+        input_trace_.start_recording();
+    }
+
+    // Stop recording
+    void stopRecording() {
+        input_trace_.stop();
+    }
+
+    // Recorded trace as a Uint8Array view
+    // (valid until the next call into the module)
+    val getRecording() {
+        const std::string& data = input_trace_.data();
+        return val(typed_memory_view(data.size(),
+                                     reinterpret_cast<const uint8_t*>(data.data())));
+    }
+
+    // Feed a recorded trace back instead of asking JavaScript for input
+    bool startReplay(const std::string& data) {
+        return input_trace_.start_replay(data);
+    }
+
+    // Stop replaying and return to live input
+    void stopReplay() {
+        input_trace_.stop();
+    }
+
+    // Check if a replay is in progress (false once the trace runs out)
+    bool isReplaying() const {
+        return input_trace_.replaying();
     }
 
     // Stop execution
@@ -89,6 +196,33 @@ public:
         if (interpreter_) {
             interpreter_->stop();
         }
+        io_->flush();
+    }
+
+    // Check if a program interrupted by Break at INPUT can be resumed with
+    // CONT. Only Break is tracked here; a STOP statement ends the run.
+    bool canContinue() const {
+        return can_continue_ && loaded_ && interpreter_ && !executing_;
+    }
+
+    // Resume a program interrupted by Break (CONT) on the live runtime,
+    // without reloading or resetting variables. The interrupted INPUT
+    // statement runs again.
+    bool cont() {
+        if (!canContinue()) {
+            last_error_ = "Can't continue";
+            return false;
+        }
+        can_continue_ = false;
+        if (debugging_) {
+            execute(debug_);
+        } else {
+            ExecutingScope scope(executing_);
+            while (step()) {
+            }
+            sampleHeap();
+        }
+        return true;
     }
 
     // Pause execution
@@ -114,21 +248,53 @@ public:
 
     // Reset execution (keep program)
     void reset() {
+        if (refuseWhileRunning()) {
+            return;
+        }
+        can_continue_ = false;
         if (runtime_) {
             runtime_->reset();
         }
     }
 
     // Clear everything
+    // The runtime objects stay allocated for the next load unless the heap
+    // is over the recycle limit.
     void clear() {
+        if (refuseWhileRunning()) {
+            return;
+        }
         loaded_ = false;
-        interpreter_.reset();
-        runtime_.reset();
-        program_.reset();
+        can_continue_ = false;
+        if (runtime_) {
+            if (heapInUse() > recycle_limit_) {
+                release();
+            } else {
+                runtime_->reset();
+            }
+        }
         program_source_.clear();
         last_error_.clear();
     }
 
+    // Set the heap size (bytes) above which runtime objects are freed
+    // instead of reset in place. 0 frees them on every load.
+    void setRecycleLimit(int bytes) {
+        recycle_limit_ = bytes;
+    }
+
+    // Get load latency and heap statistics
+    SessionStats getStats() {
+        sampleHeap();
+        return stats_;
+    }
+
+    // Reset load latency and heap statistics
+    void resetStats() {
+        stats_ = SessionStats{};
+        sampleHeap();
+    }
+
     // Get the last error message
     std::string getLastError() const {
         return last_error_;
@@ -156,36 +322,194 @@ public:
         return program_source_;
     }
 
+    // Program source without a copy (for the C ABI)
+    const std::string& programSource() const {
+        return program_source_;
+    }
+
+    // Last error without a copy (for the C ABI)
+    const std::string& lastError() const {
+        return last_error_;
+    }
+
     // Set terminal width
     void setWidth(int width) {
         io_->set_width(width);
     }
 
 private:
+    // Marks a run as active for its whole duration. ASYNCIFY suspends the
+    // run without unwinding C++ scopes, so the flag stays set while INPUT
+    // is waiting and nothing can re-enter the interpreter meanwhile.
+    struct ExecutingScope {
+        explicit ExecutingScope(bool& flag) : flag_(flag) { flag_ = true; }
+        ~ExecutingScope() { flag_ = false; }
+        bool& flag_;
+    };
+
+    // Execute one interpreter tick, reporting errors like a run does
+    bool step() {
+        if (!loaded_ || !interpreter_) {
+            return false;
+        }
+
+        bool more = false;
+        try {
+            more = interpreter_->tick();
+        } catch (const mbasic::InputBreak&) {
+            can_continue_ = true;
+        } catch (const mbasic::RuntimeError& e) {
+            last_error_ = "Runtime error at line " + std::to_string(e.line) +
+                          ": " + e.what();
+            io_->print("\n" + last_error_ + "\n");
+        } catch (const std::exception& e) {
+            last_error_ = std::string("Error: ") + e.what();
+            io_->print("\n" + last_error_ + "\n");
+        }
+        io_->flush();
+        return more;
+    }
+
+    // Run loop shared by normal and debug runs. NoDebugPolicy compiles down
+    // to a plain interpreter run; DebugPolicy steps statement by statement.
+    template <typename Policy>
+    void execute(Policy& policy) {
+        if (!loaded_ || !interpreter_ || executing_) {
+            return;
+        }
+        ExecutingScope scope(executing_);
+
+        if constexpr (!Policy::enabled) {
+            try {
+                interpreter_->run();
+            } catch (const mbasic::InputBreak&) {
+                can_continue_ = true;
+            } catch (const mbasic::RuntimeError& e) {
+                last_error_ = "Runtime error at line " + std::to_string(e.line) +
+                              ": " + e.what();
+                io_->print("\n" + last_error_ + "\n");
+            } catch (const std::exception& e) {
+                last_error_ = std::string("Error: ") + e.what();
+                io_->print("\n" + last_error_ + "\n");
+            }
+            io_->flush();
+        } else {
+            paused_line_ = mbasic::DebugPolicy::NO_LINE;
+            for (;;) {
+                int line = runtime_->pc.line;
+                if (policy.before_statement(line)) {
+                    paused_line_ = line;
+                    break;
+                }
+                if (!step()) {
+                    break;
+                }
+            }
+        }
+        sampleHeap();
+    }
+
+    // Point the runtime at a parsed program, reusing the runtime objects
+    void attach(mbasic::Program& program) {
+        loaded_ = false;
+        can_continue_ = false;
+        if (runtime_) {
+            runtime_->reset();
+            runtime_->load(program);
+            stats_.reuses++;
+        } else {
+            runtime_ = std::make_unique<mbasic::Runtime>();
+            runtime_->load(program);
+        }
+        interpreter_ = std::make_unique<mbasic::Interpreter>(*runtime_, io_.get());
+        debug_.start_run();
+        loaded_ = true;
+        paused_line_ = mbasic::DebugPolicy::NO_LINE;
+    }
+
+    // Refuse to reload, reset or free the runtime while a run is active:
+    // a run suspended in INPUT still has interpreter frames on the
+    // ASYNCIFY stack that point into it
+    bool refuseWhileRunning() {
+        if (executing_) {
+            last_error_ = "Program is running";
+            return true;
+        }
+        return false;
+    }
+
+    // Free the runtime objects so their memory returns to the allocator
+    // (callers check refuseWhileRunning first)
+    void release() {
+        loaded_ = false;
+        interpreter_.reset();
+        runtime_.reset();
+        program_.reset();
+        stats_.releases++;
+    }
+
+    static int heapInUse() {
+        return static_cast<int>(mallinfo().uordblks);
+    }
+
+    void sampleHeap() {
+        stats_.heapInUse = heapInUse();
+        stats_.heapSize = static_cast<int>(emscripten_get_heap_size());
+        if (stats_.heapInUse > stats_.heapHighWater) {
+            stats_.heapHighWater = stats_.heapInUse;
+        }
+    }
+
+    mbasic::InputTrace input_trace_;
     std::unique_ptr<mbasic::WasmIO> io_;
     std::unique_ptr<mbasic::Program> program_;
     std::unique_ptr<mbasic::Runtime> runtime_;
     std::unique_ptr<mbasic::Interpreter> interpreter_;
     std::string program_source_;
     std::string last_error_;
+    SessionStats stats_;
+    mbasic::DebugPolicy debug_;
+    int paused_line_ = mbasic::DebugPolicy::NO_LINE;
+    bool executing_ = false;  // A run is active (possibly suspended in INPUT)
+    bool can_continue_ = false;  // Last run ended by Break at INPUT
+    bool debugging_ = false;
+    int recycle_limit_ = DEFAULT_RECYCLE_LIMIT;
     bool loaded_ = false;
 };
 
-// Global session instance
-MBasicSession g_session;
+// Global session instance, constructed on first use rather than by a
+// static constructor during module startup
+MBasicSession& session() {
+    static MBasicSession instance;
+    return instance;
+}
 
 } // anonymous namespace
 
 // Embind bindings
 EMSCRIPTEN_BINDINGS(mbasic) {
 
+    value_object<SessionStats>("SessionStats")
+        .field("loads", &SessionStats::loads)
+        .field("reuses", &SessionStats::reuses)
+        .field("releases", &SessionStats::releases)
+        .field("lastLoadMs", &SessionStats::lastLoadMs)
+        .field("maxLoadMs", &SessionStats::maxLoadMs)
+        .field("totalLoadMs", &SessionStats::totalLoadMs)
+        .field("heapInUse", &SessionStats::heapInUse)
+        .field("heapHighWater", &SessionStats::heapHighWater)
+        .field("heapSize", &SessionStats::heapSize)
+        ;
+
     // Expose the session class
     class_<MBasicSession>("MBasicSession")
         .constructor<>()
         .function("loadProgram", &MBasicSession::loadProgram)
-        .function("run", &MBasicSession::run)
+        .function("run", &MBasicSession::run, async())
         .function("tick", &MBasicSession::tick)
         .function("stop", &MBasicSession::stop)
+        .function("canContinue", &MBasicSession::canContinue)
+        .function("cont", &MBasicSession::cont, async())
         .function("pause", &MBasicSession::pause)
         .function("resume", &MBasicSession::resume)
         .function("provideInput", &MBasicSession::provideInput)
@@ -197,54 +521,215 @@ EMSCRIPTEN_BINDINGS(mbasic) {
         .function("getCurrentLine", &MBasicSession::getCurrentLine)
         .function("listProgram", &MBasicSession::listProgram)
         .function("setWidth", &MBasicSession::setWidth)
+        .function("setRecycleLimit", &MBasicSession::setRecycleLimit)
+        .function("setDebugging", &MBasicSession::setDebugging)
+        .function("setBreakpoint", &MBasicSession::setBreakpoint)
+        .function("clearBreakpoints", &MBasicSession::clearBreakpoints)
+        .function("debugContinue", &MBasicSession::debugContinue, async())
+        .function("debugStep", &MBasicSession::debugStep, async())
+        .function("getPausedLine", &MBasicSession::getPausedLine)
+        .function("getTrace", &MBasicSession::getTrace)
+        .function("clearTrace", &MBasicSession::clearTrace)
+        .function("startRecording", &MBasicSession::startRecording)
+        .function("stopRecording", &MBasicSession::stopRecording)
+        .function("getRecording", &MBasicSession::getRecording)
+        .function("startReplay", &MBasicSession::startReplay)
+        .function("stopReplay", &MBasicSession::stopReplay)
+        .function("isReplaying", &MBasicSession::isReplaying)
+        .function("getStats", &MBasicSession::getStats)
+        .function("resetStats", &MBasicSession::resetStats)
         ;
 
     // Global functions for simple API
     function("loadProgram", +[](const std::string& source) -> bool {
-        return g_session.loadProgram(source);
+        return session().loadProgram(source);
     });
 
+    // May suspend in INPUT, so JavaScript gets a Promise
     function("runProgram", +[]() {
-        g_session.run();
-    });
+        session().run();
+    }, async());
 
     function("tickProgram", +[]() -> bool {
-        return g_session.tick();
+        return session().tick();
     });
 
     function("stopProgram", +[]() {
-        g_session.stop();
+        session().stop();
+    });
+
+    function("canContinue", +[]() -> bool {
+        return session().canContinue();
     });
 
+    function("continueProgram", +[]() -> bool {
+        return session().cont();
+    }, async());
+
     function("resetProgram", +[]() {
-        g_session.reset();
+        session().reset();
     });
 
     function("clearProgram", +[]() {
-        g_session.clear();
+        session().clear();
     });
 
     function("getLastError", +[]() -> std::string {
-        return g_session.getLastError();
+        return session().getLastError();
     });
 
     function("isProgramLoaded", +[]() -> bool {
-        return g_session.isLoaded();
+        return session().isLoaded();
     });
 
     function("isProgramRunning", +[]() -> bool {
-        return g_session.isRunning();
+        return session().isRunning();
     });
 
     function("provideInput", +[](const std::string& input) {
-        g_session.provideInput(input);
+        session().provideInput(input);
     });
 
     function("listProgram", +[]() -> std::string {
-        return g_session.listProgram();
+        return session().listProgram();
     });
 
     function("setTerminalWidth", +[](int width) {
-        g_session.setWidth(width);
+        session().setWidth(width);
+    });
+
+    function("setRecycleLimit", +[](int bytes) {
+        session().setRecycleLimit(bytes);
+    });
+
+    function("setDebugging", +[](bool enable) {
+        session().setDebugging(enable);
+    });
+
+    function("setBreakpoint", +[](int line, bool on) {
+        session().setBreakpoint(line, on);
+    });
+
+    function("clearBreakpoints", +[]() {
+        session().clearBreakpoints();
+    });
+
+    // Both may suspend in INPUT, so JavaScript gets a Promise
+    function("debugContinue", +[]() {
+        session().debugContinue();
+    }, async());
+
+    function("debugStep", +[]() {
+        session().debugStep();
+    }, async());
+
+    function("getPausedLine", +[]() -> int {
+        return session().getPausedLine();
+    });
+
+    function("getTrace", +[]() -> val {
+        return session().getTrace();
+    });
+
+    function("clearTrace", +[]() {
+        session().clearTrace();
+    });
+
+    function("startRecording", +[]() {
+        session().startRecording();
+    });
+
+    function("stopRecording", +[]() {
+        session().stopRecording();
+    });
+
+    function("getRecording", +[]() -> val {
+        return session().getRecording();
+    });
+
+    function("startReplay", +[](const std::string& data) -> bool {
+        return session().startReplay(data);
+    });
+
+    function("stopReplay", +[]() {
+        session().stopReplay();
+    });
+
+    function("isReplaying", +[]() -> bool {
+        return session().isReplaying();
+    });
+
+    function("getSessionStats", +[]() -> SessionStats {
+        return session().getStats();
+    });
+
+    function("resetSessionStats", +[]() {
+        session().resetStats();
     });
 }
+
+// C ABI fast path
+// Plain wasm exports for hot polling calls, callable as Module._mbasic_*
+// without embind's wrappers. Text goes through linear memory: JavaScript
+// encodes into the buffer returned by mbasic_text_buffer, and reads the
+// session's strings in place with a TextDecoder over HEAPU8 using the
+// pointer/length exports (valid until the next call into the module).
+
+namespace {
+
+// Reusable staging buffer for text coming from JavaScript
+std::vector<char> g_text_buffer;
+
+} // anonymous namespace
+
+extern "C" {
+
+// Get a buffer of at least size bytes for passing text in
+EMSCRIPTEN_KEEPALIVE char* mbasic_text_buffer(int size) {
+    if (size > static_cast<int>(g_text_buffer.size())) {
+        g_text_buffer.resize(size);
+    }
+    return g_text_buffer.data();
+}
+
+EMSCRIPTEN_KEEPALIVE int mbasic_load_program(const char* source, int length) {
+    return session().loadProgram(std::string(source, length)) ? 1 : 0;
+}
+
+EMSCRIPTEN_KEEPALIVE void mbasic_provide_input(const char* text, int length) {
+    session().provideInput(std::string(text, length));
+}
+
+EMSCRIPTEN_KEEPALIVE int mbasic_tick() {
+    return session().tick() ? 1 : 0;
+}
+
+EMSCRIPTEN_KEEPALIVE int mbasic_is_running() {
+    return session().isRunning() ? 1 : 0;
+}
+
+EMSCRIPTEN_KEEPALIVE int mbasic_is_loaded() {
+    return session().isLoaded() ? 1 : 0;
+}
+
+EMSCRIPTEN_KEEPALIVE int mbasic_current_line() {
+    return session().getCurrentLine();
+}
+
+EMSCRIPTEN_KEEPALIVE const char* mbasic_program_source() {
+    return session().programSource().data();
+}
+
+EMSCRIPTEN_KEEPALIVE int mbasic_program_source_length() {
+    return static_cast<int>(session().programSource().size());
+}
+
+EMSCRIPTEN_KEEPALIVE const char* mbasic_last_error() {
+    return session().lastError().data();
+}
+
+EMSCRIPTEN_KEEPALIVE int mbasic_last_error_length() {
+    return static_cast<int>(session().lastError().size());
+}
+
+} // extern "C"
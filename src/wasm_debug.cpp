@@ -0,0 +1,35 @@
+// MBASIC WebAssembly - Debugger Instrumentation Policies Implementation
+
+#include "wasm_debug.hpp"
+
+namespace mbasic {
+
+void DebugPolicy::set_breakpoint(int line, bool on) {
+    if (line >= 0 && line <= MAX_LINE) {
+        breakpoints_.set(line, on);
+    }
+}
+
+void DebugPolicy::clear_breakpoints() {
+    breakpoints_.reset();
+}
+
+bool DebugPolicy::has_breakpoint(int line) const {
+    return line >= 0 && line <= MAX_LINE && breakpoints_.test(line);
+}
+
+const std::vector<int32_t>& DebugPolicy::trace() {
+    ordered_.clear();
+    size_t start = (trace_pos_ + TRACE_SIZE - trace_count_) % TRACE_SIZE;
+    for (size_t i = 0; i < trace_count_; i++) {
+        ordered_.push_back(trace_[(start + i) % TRACE_SIZE]);
+    }
+    return ordered_;
+}
+
+void DebugPolicy::clear_trace() {
+    trace_pos_ = 0;
+    trace_count_ = 0;
+}
+
+} // namespace mbasic
@@ -7,18 +7,26 @@
 namespace mbasic {
 
 // JavaScript functions implemented via EM_JS
-EM_JS(void, js_print, (const char* text), {
+EM_JS(void, js_print, (const char* text, int length), {
+    // Decode the exact byte range so CHR$(0) doesn't cut the output short
+    if (!Module.printDecoder) {
+        Module.printDecoder = new TextDecoder();
+    }
+    const str = Module.printDecoder.decode(HEAPU8.subarray(text, text + length));
     if (typeof Module.onPrint === 'function') {
-        Module.onPrint(UTF8ToString(text));
+        Module.onPrint(str);
     } else {
-        console.log(UTF8ToString(text));
+        console.log(str);
     }
 });
 
 EM_ASYNC_JS(char*, js_input, (const char* prompt), {
     if (typeof Module.onInput !== 'function') {
+        // No input source: answer with an empty line
         console.error('Module.onInput not defined');
-        return 0;
+        const empty = _malloc(1);
+        HEAPU8[empty] = 0;
+        return empty;
     }
 
     // Display prompt
@@ -26,8 +34,11 @@ EM_ASYNC_JS(char*, js_input, (const char* prompt), {
         Module.onPrint(UTF8ToString(prompt));
     }
 
-    // Wait for input from JavaScript
+    // Wait for input from JavaScript (null means Break was pressed)
     const result = await Module.onInput();
+    if (result === null || result === undefined) {
+        return 0;
+    }
 
     // Allocate memory for result string and copy
     const len = lengthBytesUTF8(result) + 1;
@@ -53,7 +64,11 @@ EM_JS(void, js_clear_screen, (), {
 });
 
 void WasmIO::print(const std::string& text) {
-    js_print(text.c_str());
+    // Coalesce PRINT items so each line crosses into JavaScript once
+    output_ += text;
+    if (output_.size() >= OUTPUT_BUFFER_SIZE) {
+        flush();
+    }
 
     // Track column position
     for (char c : text) {
@@ -70,19 +85,55 @@ void WasmIO::print(const std::string& text) {
     }
 }
 
+void WasmIO::flush() {
+    if (!output_.empty()) {
+        js_print(output_.data(), static_cast<int>(output_.size()));
+        output_.clear();
+    }
+}
+
 std::string WasmIO::input(const std::string& prompt) {
+    flush();
+    std::string s;
+    if (trace_ && trace_->replaying()) {
+        // Echo prompt and answer the way the terminal would
+        if (trace_->replay_input_break()) {
+            print(prompt + "\n");
+            flush();
+            throw InputBreak{};
+        }
+        if (trace_->replay_input(s)) {
+            print(prompt + s + "\n");
+            return s;
+        }
+    }
+
     char* result = js_input(prompt.c_str());
-    if (result) {
-        std::string s(result);
-        std::free(result);
-        column_ = 0;  // Input ends with newline
-        return s;
+    if (!result) {
+        // Break: abandon the INPUT statement
+        if (trace_ && trace_->recording()) {
+            trace_->record_input_break();
+        }
+        throw InputBreak{};
+    }
+    s = result;
+    std::free(result);
+    column_ = 0;  // Input ends with newline
+    if (trace_ && trace_->recording()) {
+        trace_->record_input(s);
     }
-    return "";
+    return s;
 }
 
 std::optional<char> WasmIO::inkey() {
-    int key = js_inkey();
+    flush();
+    int key = -1;
+    if (!(trace_ && trace_->replaying() && trace_->replay_inkey(key))) {
+        key = js_inkey();
+        if (trace_ && trace_->recording()) {
+            trace_->record_inkey(key);
+        }
+    }
     if (key >= 0) {
         return static_cast<char>(key);
     }
@@ -90,6 +141,7 @@ std::optional<char> WasmIO::inkey() {
 }
 
 void WasmIO::clear_screen() {
+    output_.clear();
     js_clear_screen();
     column_ = 0;
 }
@@ -0,0 +1,170 @@
+// MBASIC WebAssembly - Input Record/Replay Implementation
+//
+// Trace layout: "MBTR" + version byte, then a sequence of events, each a
+// tag byte followed by its payload. Integers are LEB128 varints and strings
+// are a varint length followed by raw bytes.
+
+#include "wasm_replay.hpp"
+
+namespace mbasic {
+
+namespace {
+const char TRACE_MAGIC[] = "MBTR";
+const size_t TRACE_MAGIC_LEN = 4;
+const char TRACE_VERSION = 1;
+} // anonymous namespace
+
+void InputTrace::start_recording() {
+    data_.assign(TRACE_MAGIC, TRACE_MAGIC_LEN);
+    data_ += TRACE_VERSION;
+    no_key_run_ = 0;
+    mode_ = Mode::RECORD;
+}
+
+bool InputTrace::start_replay(const std::string& data) {
+    if (data.size() < TRACE_MAGIC_LEN + 1 ||
+        data.compare(0, TRACE_MAGIC_LEN, TRACE_MAGIC) != 0 ||
+        data[TRACE_MAGIC_LEN] != TRACE_VERSION) {
+        return false;
+    }
+    data_ = data;
+    pos_ = TRACE_MAGIC_LEN + 1;
+    no_key_run_ = 0;
+    mode_ = Mode::REPLAY;
+    return true;
+}
+
+void InputTrace::stop() {
+    if (mode_ == Mode::RECORD) {
+        flush_no_key();
+    }
+    mode_ = Mode::OFF;
+}
+
+const std::string& InputTrace::data() {
+    if (mode_ == Mode::RECORD) {
+        flush_no_key();
+    }
+    return data_;
+}
+
+void InputTrace::record_input(const std::string& line) {
+    flush_no_key();
+    data_ += static_cast<char>(TAG_INPUT);
+    put_string(line);
+}
+
+bool InputTrace::replay_input(std::string& line) {
+    if (!expect(TAG_INPUT) || !get_string(line)) {
+        mismatch();
+        return false;
+    }
+    return true;
+}
+
+void InputTrace::record_input_break() {
+    flush_no_key();
+    data_ += static_cast<char>(TAG_BREAK);
+}
+
+// Consumes the event only if the next one is a Break, so replay_input can
+// be tried afterwards
+bool InputTrace::replay_input_break() {
+    return expect(TAG_BREAK);
+}
+
+void InputTrace::record_inkey(int key) {
+    if (key < 0) {
+        no_key_run_++;
+        return;
+    }
+    flush_no_key();
+    data_ += static_cast<char>(TAG_KEY);
+    data_ += static_cast<char>(key);
+}
+
+bool InputTrace::replay_inkey(int& key) {
+    if (no_key_run_ > 0) {
+        no_key_run_--;
+        key = -1;
+        return true;
+    }
+    if (pos_ < data_.size() && static_cast<uint8_t>(data_[pos_]) == TAG_NO_KEY) {
+        pos_++;
+        if (!get_varint(no_key_run_) || no_key_run_ == 0) {
+            mismatch();
+            return false;
+        }
+        no_key_run_--;
+        key = -1;
+        return true;
+    }
+    if (!expect(TAG_KEY) || pos_ >= data_.size()) {
+        mismatch();
+        return false;
+    }
+    key = static_cast<uint8_t>(data_[pos_++]);
+    return true;
+}
+
+void InputTrace::flush_no_key() {
+    if (no_key_run_ > 0) {
+        data_ += static_cast<char>(TAG_NO_KEY);
+        put_varint(no_key_run_);
+        no_key_run_ = 0;
+    }
+}
+
+void InputTrace::put_varint(uint32_t value) {
+    while (value >= 0x80) {
+        data_ += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    data_ += static_cast<char>(value);
+}
+
+void InputTrace::put_string(const std::string& s) {
+    put_varint(static_cast<uint32_t>(s.size()));
+    data_ += s;
+}
+
+bool InputTrace::get_varint(uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (pos_ >= data_.size()) {
+            return false;
+        }
+        uint8_t byte = static_cast<uint8_t>(data_[pos_++]);
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool InputTrace::get_string(std::string& s) {
+    uint32_t len = 0;
+    if (!get_varint(len) || data_.size() - pos_ < len) {
+        return false;
+    }
+    s.assign(data_, pos_, len);
+    pos_ += len;
+    return true;
+}
+
+bool InputTrace::expect(Tag tag) {
+    if (pos_ < data_.size() && static_cast<uint8_t>(data_[pos_]) == tag) {
+        pos_++;
+        return true;
+    }
+    return false;
+}
+
+// The program asked for something the trace doesn't have (trace exhausted
+// or the program diverged); drop back to live input
+void InputTrace::mismatch() {
+    mode_ = Mode::OFF;
+}
+
+} // namespace mbasic
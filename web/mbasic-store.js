@@ -0,0 +1,309 @@
+// MBASIC 5.21 WebAssembly - Persistent Virtual File Store
+// Map-compatible file store for the UI's virtual files.
+// File contents are split into fixed-size blocks; only blocks whose contents
+// changed since the last sync are written back, through a write-behind queue
+// that coalesces flushes.
+
+// Characters per stored block
+export const BLOCK_SIZE = 4096;
+
+// Delay before dirty blocks are written back (coalesces repeated flushes)
+const WRITE_BEHIND_MS = 250;
+
+const META_PREFIX = 'file:';
+const BLOCK_PREFIX = 'block:';
+
+function metaKey(name) {
+    return META_PREFIX + name;
+}
+
+function blockKey(name, index) {
+    return `${BLOCK_PREFIX}${name}:${index}`;
+}
+
+function blockCount(size) {
+    return Math.ceil(size / BLOCK_SIZE);
+}
+
+// In-memory backend (stand-in for IndexedDB, usable from Node)
+export class MemoryBackend {
+    constructor() {
+        this.records = new Map();
+        this.bytesWritten = 0;
+        this.writes = 0;
+    }
+
+    async loadAll() {
+        return new Map(this.records);
+    }
+
+    async write(puts, deletes) {
+        for (const [key, value] of puts) {
+            this.records.set(key, value);
+            if (typeof value === 'string') {
+                this.bytesWritten += value.length;
+            }
+        }
+        for (const key of deletes) {
+            this.records.delete(key);
+        }
+        this.writes++;
+    }
+}
+
+// IndexedDB backend
+export class IndexedDBBackend {
+    constructor(dbName = 'mbasic-files', storeName = 'blocks') {
+        this.dbName = dbName;
+        this.storeName = storeName;
+        this.db = null;
+    }
+
+    open() {
+        if (this.db) {
+            return Promise.resolve(this.db);
+        }
+        return new Promise((resolve, reject) => {
+            const request = indexedDB.open(this.dbName, 1);
+            request.onupgradeneeded = () => {
+                request.result.createObjectStore(this.storeName);
+            };
+            request.onsuccess = () => {
+                this.db = request.result;
+                resolve(this.db);
+            };
+            request.onerror = () => reject(request.error);
+        });
+    }
+
+    async loadAll() {
+        const db = await this.open();
+        return new Promise((resolve, reject) => {
+            const records = new Map();
+            const transaction = db.transaction(this.storeName, 'readonly');
+            const request = transaction.objectStore(this.storeName).openCursor();
+            request.onsuccess = () => {
+                const cursor = request.result;
+                if (cursor) {
+                    records.set(cursor.key, cursor.value);
+                    cursor.continue();
+                } else {
+                    resolve(records);
+                }
+            };
+            request.onerror = () => reject(request.error);
+        });
+    }
+
+    async write(puts, deletes) {
+        const db = await this.open();
+        return new Promise((resolve, reject) => {
+            const transaction = db.transaction(this.storeName, 'readwrite');
+            const store = transaction.objectStore(this.storeName);
+            for (const [key, value] of puts) {
+                store.put(value, key);
+            }
+            for (const key of deletes) {
+                store.delete(key);
+            }
+            transaction.oncomplete = () => resolve();
+            transaction.onerror = () => reject(transaction.error);
+            // Quota errors abort the transaction without an error event
+            transaction.onabort = () =>
+                reject(transaction.error || new Error('Transaction aborted'));
+        });
+    }
+}
+
+// Persistent file store with block-level dirty tracking
+export class FileStore {
+    constructor(backend = new MemoryBackend()) {
+        this.backend = backend;
+        this.files = new Map();         // name -> contents
+        this.storedSizes = new Map();   // name -> size last written to backend
+        this.dirty = new Map();         // name -> Set of dirty block indexes
+        this.removed = new Set();       // names deleted since the last sync
+        this.timer = null;
+        this.syncing = Promise.resolve();
+    }
+
+    // Read all files from the backend
+    async load() {
+        const records = await this.backend.loadAll();
+        for (const [key, meta] of records) {
+            if (!key.startsWith(META_PREFIX)) {
+                continue;
+            }
+            const name = key.substring(META_PREFIX.length);
+            const blocks = [];
+            for (let i = 0; i < blockCount(meta.size); i++) {
+                blocks.push(records.get(blockKey(name, i)) || '');
+            }
+            this.files.set(name, blocks.join('').substring(0, meta.size));
+            this.storedSizes.set(name, meta.size);
+        }
+    }
+
+    // Map interface
+
+    get size() {
+        return this.files.size;
+    }
+
+    has(name) {
+        return this.files.has(name);
+    }
+
+    get(name) {
+        return this.files.get(name);
+    }
+
+    keys() {
+        return this.files.keys();
+    }
+
+    entries() {
+        return this.files.entries();
+    }
+
+    [Symbol.iterator]() {
+        return this.files.entries();
+    }
+
+    // Replace a whole file, marking only the blocks that differ
+    set(name, data) {
+        const old = this.files.get(name);
+        this.files.set(name, data);
+        this.removed.delete(name);
+
+        let blocks = this.dirty.get(name);
+        if (!blocks) {
+            blocks = new Set();
+        }
+        const count = blockCount(data.length);
+        for (let i = 0; i < count; i++) {
+            const start = i * BLOCK_SIZE;
+            if (old === undefined ||
+                data.substring(start, start + BLOCK_SIZE) !==
+                    old.substring(start, start + BLOCK_SIZE)) {
+                blocks.add(i);
+            }
+        }
+        if (old !== undefined && old.length === data.length && blocks.size === 0) {
+            return this;
+        }
+        // A size change still rewrites the metadata and trims stale blocks
+        this.dirty.set(name, blocks);
+        this.schedule();
+        return this;
+    }
+
+    delete(name) {
+        if (!this.files.has(name)) {
+            return false;
+        }
+        this.files.delete(name);
+        this.dirty.delete(name);
+        this.removed.add(name);
+        this.schedule();
+        return true;
+    }
+
+    // Queue a write-back; repeated calls before it runs are coalesced
+    schedule() {
+        if (this.timer === null) {
+            this.timer = setTimeout(() => {
+                this.timer = null;
+                this.sync();
+            }, WRITE_BEHIND_MS);
+        }
+    }
+
+    // Write dirty blocks to the backend now
+    // Write-backs run one at a time; each picks up whatever is dirty when
+    // its turn comes.
+    sync() {
+        if (this.timer !== null) {
+            clearTimeout(this.timer);
+            this.timer = null;
+        }
+        this.syncing = this.syncing.then(() => this.writeBack());
+        return this.syncing;
+    }
+
+    async writeBack() {
+        const dirty = this.dirty;
+        const removed = this.removed;
+        this.dirty = new Map();
+        this.removed = new Set();
+
+        const puts = [];
+        const deletes = [];
+        const sizes = new Map();    // name -> size being written
+
+        for (const name of removed) {
+            const size = this.storedSizes.get(name) || 0;
+            deletes.push(metaKey(name));
+            for (let i = 0; i < blockCount(size); i++) {
+                deletes.push(blockKey(name, i));
+            }
+        }
+
+        for (const [name, blocks] of dirty) {
+            const data = this.files.get(name);
+            for (const i of blocks) {
+                puts.push([blockKey(name, i),
+                           data.substring(i * BLOCK_SIZE, (i + 1) * BLOCK_SIZE)]);
+            }
+            const oldSize = this.storedSizes.get(name) || 0;
+            for (let i = blockCount(data.length); i < blockCount(oldSize); i++) {
+                deletes.push(blockKey(name, i));
+            }
+            puts.push([metaKey(name), { size: data.length }]);
+            sizes.set(name, data.length);
+        }
+
+        if (puts.length === 0 && deletes.length === 0) {
+            return;
+        }
+
+        try {
+            await this.backend.write(puts, deletes);
+        } catch (error) {
+            console.error('File store write failed:', error);
+            this.requeue(dirty, removed);
+            return;
+        }
+
+        // The backend now holds these sizes
+        for (const name of removed) {
+            this.storedSizes.delete(name);
+        }
+        for (const [name, size] of sizes) {
+            this.storedSizes.set(name, size);
+        }
+    }
+
+    // Put the work of a failed write-back back in the queue, skipping
+    // anything superseded since (it goes out with the next sync)
+    requeue(dirty, removed) {
+        for (const name of removed) {
+            if (!this.files.has(name)) {
+                this.removed.add(name);
+            }
+        }
+        for (const [name, blocks] of dirty) {
+            if (!this.files.has(name)) {
+                continue;
+            }
+            const pending = this.dirty.get(name) || new Set();
+            const count = blockCount(this.files.get(name).length);
+            for (const i of blocks) {
+                if (i < count) {
+                    pending.add(i);
+                }
+            }
+            this.dirty.set(name, pending);
+        }
+    }
+}
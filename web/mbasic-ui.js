@@ -1,6 +1,8 @@
 // MBASIC 5.21 WebAssembly - User Interface
 // Provides terminal interaction and file management for the BASIC interpreter
 
+import { FileStore, IndexedDBBackend, MemoryBackend } from './mbasic-store.js';
+
 // Module will be loaded from mbasic.js
 let Module = null;
 
@@ -20,11 +22,44 @@ const fileList = document.getElementById('file-list');
 
 // State
 let isRunning = false;
+let breakRequested = false;
 let inputResolve = null;
 let inputBuffer = [];
 let commandHistory = [];
 let historyIndex = -1;
-let virtualFiles = new Map();
+// Persistent file store, shared with the WASM file system
+let virtualFiles = new FileStore(
+    typeof indexedDB !== 'undefined' ? new IndexedDBBackend() : new MemoryBackend());
+
+// Text transfer through wasm linear memory (C ABI fast path)
+const textEncoder = new TextEncoder();
+const textDecoder = new TextDecoder();
+
+// Load program source via the C ABI, encoding straight into wasm memory
+function loadSource(source) {
+    const capacity = source.length * 3;
+    const ptr = Module._mbasic_text_buffer(capacity);
+    const { written } = textEncoder.encodeInto(
+        source, Module.HEAPU8.subarray(ptr, ptr + capacity));
+    return Module._mbasic_load_program(ptr, written) !== 0;
+}
+
+// Decode a session string in place from wasm memory
+function decodeText(ptr, length) {
+    return textDecoder.decode(Module.HEAPU8.subarray(ptr, ptr + length));
+}
+
+// Read the program listing via the C ABI
+function listSource() {
+    return decodeText(Module._mbasic_program_source(),
+                      Module._mbasic_program_source_length());
+}
+
+// Read the last error message via the C ABI
+function lastError() {
+    return decodeText(Module._mbasic_last_error(),
+                      Module._mbasic_last_error_length());
+}
 
 // Print text to the terminal
 function print(text) {
@@ -99,7 +134,7 @@ function processCommand(cmd) {
 
     if (trimmed === 'LIST') {
         if (Module) {
-            const listing = Module.listProgram();
+            const listing = listSource();
             if (listing) {
                 print(listing + '\n');
             }
@@ -113,6 +148,11 @@ function processCommand(cmd) {
         return;
     }
 
+    if (trimmed === 'CONT') {
+        continueProgram();
+        return;
+    }
+
     if (trimmed === 'CLS') {
         clearScreen();
         print('Ok\n');
@@ -130,6 +170,27 @@ function processCommand(cmd) {
         return;
     }
 
+    if (trimmed.startsWith('MERGE ')) {
+        const filename = cmd.trim().substring(6).trim().replace(/"/g, '');
+        mergeFile(filename);
+        return;
+    }
+
+    if (trimmed.startsWith('CHAIN ')) {
+        // CHAIN "filename"
+        const rest = cmd.trim().substring(6).trim();
+        if (rest.toUpperCase().startsWith('MERGE ') || rest.includes(',')) {
+            // MERGE, starting line, ALL and DELETE keep variables across
+            // the chain, which needs interpreter support
+            printError('CHAIN MERGE and CHAIN options not supported\n');
+            print('Ok\n');
+            return;
+        }
+        const filename = rest.replace(/"/g, '');
+        chainFile(filename);
+        return;
+    }
+
     if (trimmed.startsWith('SAVE ')) {
         const filename = cmd.substring(5).trim().replace(/"/g, '');
         saveFile(filename);
@@ -148,8 +209,15 @@ function processCommand(cmd) {
 
 // Add a numbered line to the editor
 function addLineToEditor(line) {
+    if (mergeLine(line)) {
+        print('Ok\n');
+    }
+}
+
+// Insert, replace or delete a numbered line in the editor
+function mergeLine(line) {
     const match = line.match(/^(\d+)/);
-    if (!match) return;
+    if (!match) return false;
 
     const lineNum = parseInt(match[1]);
     const lines = editor.value.split('\n').filter(l => l.trim());
@@ -182,7 +250,7 @@ function addLineToEditor(line) {
     });
 
     editor.value = newLines.join('\n');
-    print('Ok\n');
+    return true;
 }
 
 // Execute an immediate command
@@ -213,35 +281,71 @@ function runProgram() {
 
     print('\n');
 
-    if (Module.loadProgram(source)) {
-        isRunning = true;
-        btnRun.disabled = true;
-        btnStop.disabled = false;
-        prompt.textContent = '';
-
-        Module.runProgram();
-
-        isRunning = false;
-        btnRun.disabled = false;
-        btnStop.disabled = true;
-        prompt.textContent = 'Ok';
-        print('\nOk\n');
+    if (loadSource(source)) {
+        executeLoaded();
     } else {
-        printError(Module.getLastError() + '\n');
+        printError(lastError() + '\n');
         print('Ok\n');
     }
 }
 
-// Stop the running program
-function stopProgram() {
-    if (Module) {
-        Module.stopProgram();
+// Execute the program currently loaded in the session
+// (the run returns a Promise that settles when the program ends,
+// after any INPUT waits)
+async function executeLoaded(start = () => Module.runProgram()) {
+    isRunning = true;
+    breakRequested = false;
+    btnRun.disabled = true;
+    btnStop.disabled = false;
+    prompt.textContent = '';
+
+    try {
+        await start();
+    } catch (error) {
+        printError(`${error.message}\n`);
     }
+
     isRunning = false;
     btnRun.disabled = false;
     btnStop.disabled = true;
     prompt.textContent = 'Ok';
-    print('\nBreak\nOk\n');
+    print(breakRequested ? '\nBreak\nOk\n' : '\nOk\n');
+}
+
+// Resume after Break at INPUT (CONT) with the program's variables intact
+function continueProgram() {
+    if (!Module) {
+        printError('WASM module not loaded\n');
+        return;
+    }
+
+    if (!Module.canContinue()) {
+        printError("Can't continue\n");
+        print('Ok\n');
+        return;
+    }
+
+    executeLoaded(() => Module.continueProgram());
+}
+
+// Stop the running program
+// The program ends (and the UI resets) when its run Promise settles
+function stopProgram() {
+    if (!isRunning) {
+        return;
+    }
+    breakRequested = true;
+
+    if (inputResolve) {
+        // Waiting in INPUT: answer with null so the session abandons the
+        // INPUT statement from inside the run, rather than calling into the
+        // module while it is suspended
+        const resolve = inputResolve;
+        inputResolve = null;
+        resolve(null);
+    } else if (Module) {
+        Module.stopProgram();
+    }
 }
 
 // List virtual files
@@ -269,6 +373,45 @@ function loadFile(filename) {
     }
 }
 
+// Find a file in the virtual filesystem, trying the upper-case name too
+function findFile(filename) {
+    if (virtualFiles.has(filename)) {
+        return filename;
+    }
+    if (virtualFiles.has(filename.toUpperCase())) {
+        return filename.toUpperCase();
+    }
+    return null;
+}
+
+// Merge a file's numbered lines into the current program
+function mergeFile(filename) {
+    const name = findFile(filename);
+    if (name === null) {
+        printError(`File not found: ${filename}\n`);
+        print('Ok\n');
+        return;
+    }
+    for (const line of virtualFiles.get(name).split('\n')) {
+        mergeLine(line.trim());
+    }
+    print('Ok\n');
+}
+
+// Chain to another program (CHAIN): load it in place of the current
+// program and run it from the start
+function chainFile(filename) {
+    const name = findFile(filename);
+    if (name === null) {
+        printError(`File not found: ${filename}\n`);
+        print('Ok\n');
+        return;
+    }
+
+    editor.value = virtualFiles.get(name);
+    runProgram();
+}
+
 // Save to virtual filesystem
 function saveFile(filename) {
     virtualFiles.set(filename, editor.value);
@@ -404,6 +547,16 @@ function setupEventHandlers() {
         }
     });
 
+    // Write pending file changes before the tab is hidden or closed
+    window.addEventListener('pagehide', () => {
+        virtualFiles.sync();
+    });
+    document.addEventListener('visibilitychange', () => {
+        if (document.visibilityState === 'hidden') {
+            virtualFiles.sync();
+        }
+    });
+
     // Focus terminal on click
     document.getElementById('terminal').addEventListener('click', () => {
         input.focus();
@@ -419,6 +572,7 @@ async function init() {
         const createModule = (await import('./mbasic.js')).default;
 
         Module = await createModule({
+
             // I/O callbacks
             onPrint: (text) => {
                 print(text);
@@ -469,6 +623,13 @@ async function init() {
             }
         });
 
+        try {
+            await virtualFiles.load();
+        } catch (error) {
+            printError(`Could not load saved files: ${error.message}\n`);
+        }
+        updateFileList();
+
         clearScreen();
         print('MBASIC Version 5.21\n');
         print('c++ WebAssembly  git@github.com:avwohl/mbasicc_web.git\n');